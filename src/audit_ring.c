@@ -0,0 +1,245 @@
+#include "audit_ring.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "shm_file.h"
+
+/* Build the mark a producer stores in a slot's sequence while copying into position pos. */
+static uint64_t writing_mark(uint64_t pos)
+{
+    return AUDIT_SEQ_WRITING | ((uint64_t)(uint32_t)getpid() << 32) | (uint32_t)pos;
+}
+
+/* Return whether seq is a writing mark for position pos. */
+static int is_writing_mark(uint64_t seq, uint64_t pos)
+{
+    return (seq & AUDIT_SEQ_WRITING) != 0 && (uint32_t)seq == (uint32_t)pos;
+}
+
+/*
+ * Compare a slot's sequence with the position a producer wants. A writing
+ * mark counts as already claimed for its position, like a published slot.
+ */
+static int64_t sequence_diff(uint64_t seq, uint64_t pos)
+{
+    if ((seq & AUDIT_SEQ_WRITING) != 0) {
+        return (int32_t)((uint32_t)seq + 1U - (uint32_t)pos);
+    }
+    return (int64_t)(seq - pos);
+}
+
+/* Check that a mapped audit ring matches the layout compiled into this binary. */
+static int audit_header_ok(const void *base)
+{
+    const audit_ring *ring = (const audit_ring *)base;
+
+    return __atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) == AUDIT_MAGIC &&
+           ring->version == AUDIT_VERSION &&
+           ring->capacity == AUDIT_CAPACITY &&
+           ring->record_size == sizeof(audit_record);
+}
+
+/* Mark every slot free for the first lap, then publish the header. */
+static void audit_header_init(void *base)
+{
+    audit_ring *ring = (audit_ring *)base;
+    uint32_t i;
+
+    for (i = 0; i < AUDIT_CAPACITY; ++i) {
+        ring->slots[i].sequence = i;
+    }
+
+    ring->version = AUDIT_VERSION;
+    ring->capacity = AUDIT_CAPACITY;
+    ring->record_size = sizeof(audit_record);
+    /* Publish the magic last so producers never use a half-initialized ring. */
+    __atomic_store_n(&ring->magic, AUDIT_MAGIC, __ATOMIC_RELEASE);
+}
+
+/* Map the shared audit ring under retry_dir, creating it on first use. */
+audit_ring *audit_ring_open(const char *retry_dir)
+{
+    return (audit_ring *)shm_file_map(retry_dir, AUDIT_FILE_NAME, sizeof(audit_ring), 1,
+                                      audit_header_ok, audit_header_init);
+}
+
+/* Unmap a ring returned by audit_ring_open(). NULL is accepted. */
+void audit_ring_close(audit_ring *ring)
+{
+    shm_file_unmap(ring, sizeof(audit_ring));
+}
+
+/* Append a record without blocking. Returns -1 and counts a drop if the ring is full. */
+int audit_ring_push(audit_ring *ring, const audit_record *record)
+{
+    audit_slot *slot;
+    uint64_t pos;
+    uint64_t seq;
+
+    if (ring == NULL || record == NULL) {
+        return -1;
+    }
+
+    pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    for (;;) {
+        int64_t diff;
+
+        slot = &ring->slots[pos & (AUDIT_CAPACITY - 1)];
+        seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        diff = sequence_diff(seq, pos);
+
+        if (diff == 0) {
+            /* The slot is free for this lap: try to claim position pos. */
+            if (__atomic_compare_exchange_n(&ring->head, &pos, pos + 1, 1, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* The consumer has not drained this slot yet: the ring is full. */
+            (void)__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+            return -1;
+        } else {
+            /* Another producer claimed pos first; retry at the current head. */
+            pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    /*
+     * Mark the slot as being written before touching the record. If this
+     * producer stalled after claiming pos and the consumer skipped the slot,
+     * the mark fails and the record is dropped without writing into a slot
+     * that may already belong to the next lap. Once marked, only
+     * audit_ring_skip() on a dead producer can take the slot away.
+     */
+    seq = pos;
+    if (!__atomic_compare_exchange_n(&slot->sequence, &seq, writing_mark(pos), 0, __ATOMIC_ACQUIRE,
+                                     __ATOMIC_RELAXED)) {
+        (void)__atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    slot->record = *record;
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * Drain up to max_records published records in order. Only one consumer may
+ * call this at a time; pam_pin_audit_tail enforces that with a lock file.
+ */
+size_t audit_ring_pop_batch(audit_ring *ring, audit_record *out, size_t max_records)
+{
+    uint64_t pos;
+    size_t n = 0;
+
+    if (ring == NULL || out == NULL) {
+        return 0;
+    }
+
+    pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    while (n < max_records) {
+        audit_slot *slot = &ring->slots[pos & (AUDIT_CAPACITY - 1)];
+        uint64_t seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+        /* Stop at an empty slot or one whose producer is still copying (writing mark). */
+        if (seq != pos + 1) {
+            break;
+        }
+
+        out[n++] = slot->record;
+        /* Hand the slot back to producers for the next lap. */
+        __atomic_store_n(&slot->sequence, pos + AUDIT_CAPACITY, __ATOMIC_RELEASE);
+        ++pos;
+    }
+
+    __atomic_store_n(&ring->tail, pos, __ATOMIC_RELEASE);
+    return n;
+}
+
+/* Return records dropped since the consumer last asked. Consumer-only, like pop. */
+uint64_t audit_ring_take_dropped(audit_ring *ring)
+{
+    uint64_t dropped;
+    uint64_t fresh;
+
+    if (ring == NULL) {
+        return 0;
+    }
+
+    dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    fresh = dropped - ring->dropped_reported;
+    ring->dropped_reported = dropped;
+    return fresh;
+}
+
+/*
+ * Report whether the consumer is blocked on a slot that a producer claimed
+ * or is writing but has not published yet. Consumer-only, like pop.
+ */
+int audit_ring_stalled(const audit_ring *ring, uint64_t *pos_out)
+{
+    uint64_t tail;
+    uint64_t head;
+    uint64_t seq;
+
+    if (ring == NULL) {
+        return 0;
+    }
+
+    tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    if (head <= tail) {
+        return 0;
+    }
+
+    seq = __atomic_load_n(&ring->slots[tail & (AUDIT_CAPACITY - 1)].sequence, __ATOMIC_ACQUIRE);
+    if (seq != tail && !is_writing_mark(seq, tail)) {
+        return 0;
+    }
+
+    if (pos_out != NULL) {
+        *pos_out = tail;
+    }
+    return 1;
+}
+
+/*
+ * Give up on an unpublished slot at pos and hand it back to producers. A
+ * slot that was only claimed is always safe to take: its producer's mark
+ * then fails and it never writes. A slot with a writing mark is only taken
+ * once the marking pid no longer exists, so a live producer is never
+ * overtaken mid-copy. Returns -1 if the slot was published, is still being
+ * written, or the tail moved in the meantime. Consumer-only, like pop.
+ */
+int audit_ring_skip(audit_ring *ring, uint64_t pos)
+{
+    audit_slot *slot;
+    uint64_t seq;
+
+    if (ring == NULL || __atomic_load_n(&ring->tail, __ATOMIC_RELAXED) != pos) {
+        return -1;
+    }
+
+    slot = &ring->slots[pos & (AUDIT_CAPACITY - 1)];
+    seq = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+    if (is_writing_mark(seq, pos)) {
+        pid_t writer = (pid_t)((seq & ~AUDIT_SEQ_WRITING) >> 32);
+
+        if (kill(writer, 0) == 0 || errno != ESRCH) {
+            return -1;
+        }
+    } else if (seq != pos) {
+        return -1;
+    }
+
+    if (!__atomic_compare_exchange_n(&slot->sequence, &seq, pos + AUDIT_CAPACITY, 0, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+
+    __atomic_store_n(&ring->tail, pos + 1, __ATOMIC_RELEASE);
+    return 0;
+}
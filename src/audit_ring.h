@@ -0,0 +1,67 @@
+#ifndef PAM_PIN_AUDIT_RING_H
+#define PAM_PIN_AUDIT_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AUDIT_FILE_NAME "pam_pin.audit"
+#define AUDIT_MAGIC 0x50504e41U
+#define AUDIT_VERSION 2U
+
+/* Must be a power of two so positions map to slots with a mask. */
+#define AUDIT_CAPACITY 4096U
+#define AUDIT_USER_LEN 64
+#define AUDIT_SERVICE_LEN 32
+
+/* One fixed-size authentication attempt as written by pam_sm_authenticate. */
+typedef struct audit_record {
+    uint64_t timestamp_ns;
+    /* Time spent in the module, excluding the wait at the PIN prompt. */
+    uint64_t latency_us;
+    int32_t pid;
+    int32_t pam_rc;
+    int32_t outcome;
+    int32_t retry_count;
+    char user[AUDIT_USER_LEN];
+    char service[AUDIT_SERVICE_LEN];
+} audit_record;
+
+/*
+ * A slot's sequence equals its position when free for that lap, holds an
+ * AUDIT_SEQ_WRITING mark while a producer copies its record in, and becomes
+ * position + 1 once the record is published. The mark carries the
+ * producer's pid in bits 32-62 and the low 32 bits of the position.
+ */
+#define AUDIT_SEQ_WRITING (1ULL << 63)
+
+typedef struct audit_slot {
+    uint64_t sequence;
+    audit_record record;
+} __attribute__((aligned(64))) audit_slot;
+
+/*
+ * Bounded multi-producer, single-consumer ring shared through a root-only
+ * file under retry_dir. Producers never wait: when the ring is full the
+ * record is dropped and counted instead.
+ */
+typedef struct audit_ring {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t record_size;
+    uint64_t head __attribute__((aligned(64)));
+    uint64_t tail __attribute__((aligned(64)));
+    uint64_t dropped_reported;
+    uint64_t dropped __attribute__((aligned(64)));
+    audit_slot slots[AUDIT_CAPACITY];
+} audit_ring;
+
+audit_ring *audit_ring_open(const char *retry_dir);
+void audit_ring_close(audit_ring *ring);
+int audit_ring_push(audit_ring *ring, const audit_record *record);
+size_t audit_ring_pop_batch(audit_ring *ring, audit_record *out, size_t max_records);
+uint64_t audit_ring_take_dropped(audit_ring *ring);
+int audit_ring_stalled(const audit_ring *ring, uint64_t *pos_out);
+int audit_ring_skip(audit_ring *ring, uint64_t pos);
+
+#endif
@@ -0,0 +1,35 @@
+#include "file_check.h"
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * Require a root-owned regular file with no group/other permissions, to
+ * avoid tampering or disclosure. st_out, when not NULL, receives the fstat.
+ */
+int file_check_root_only(int fd, struct stat *st_out)
+{
+    struct stat st;
+
+    if (fstat(fd, &st) != 0) {
+        return -1;
+    }
+
+    if (st_out != NULL) {
+        *st_out = st;
+    }
+
+    if (!S_ISREG(st.st_mode)) {
+        return -1;
+    }
+
+    if (st.st_uid != 0) {
+        return -1;
+    }
+
+    if ((st.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,8 @@
+#ifndef PAM_PIN_FILE_CHECK_H
+#define PAM_PIN_FILE_CHECK_H
+
+#include <sys/stat.h>
+
+int file_check_root_only(int fd, struct stat *st_out);
+
+#endif
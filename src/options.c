@@ -4,9 +4,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define DEFAULT_PIN_DB "/etc/security/pam_pin.db"
-#define DEFAULT_RETRY_DIR "/run/pam_pin"
-
 /* Require absolute paths without ".." segments. */
 static int path_is_absolute_clean(const char *path)
 {
@@ -40,8 +37,8 @@ static int clamp_int(int value, int minv, int maxv)
     return value;
 }
 
-/* Parse a base-10 integer string with strict validation. */
-static int parse_int(const char *value, int *out)
+/* Parse a base-10 integer string with strict validation. Shared with the helper tools. */
+int options_parse_int(const char *value, int *out)
 {
     char *end = NULL;
     long parsed;
@@ -73,6 +70,9 @@ void options_set_defaults(module_options *opts)
     opts->max_tries = 3;
     opts->fail_delay_ms = 500;
     opts->debug = 0;
+    opts->stats = 0;
+    opts->profile = 0;
+    opts->audit = 0;
     opts->pin_min_len = 4;
     opts->pin_max_len = 10;
     (void)strncpy(opts->pin_db, DEFAULT_PIN_DB, sizeof(opts->pin_db) - 1);
@@ -86,7 +86,7 @@ void options_parse(module_options *opts, int argc, const char **argv)
 {
     int i;
 
-    /* Parse PAM module arguments in key=value form plus the debug flag. */
+    /* Parse PAM module arguments in key=value form plus boolean flags. */
     for (i = 0; i < argc; ++i) {
         const char *arg = argv[i];
         const char *eq;
@@ -101,13 +101,28 @@ void options_parse(module_options *opts, int argc, const char **argv)
             continue;
         }
 
+        if (strcmp(arg, "stats") == 0) {
+            opts->stats = 1;
+            continue;
+        }
+
+        if (strcmp(arg, "profile") == 0) {
+            opts->profile = 1;
+            continue;
+        }
+
+        if (strcmp(arg, "audit") == 0) {
+            opts->audit = 1;
+            continue;
+        }
+
         eq = strchr(arg, '=');
         if (eq == NULL) {
             continue;
         }
 
         if (strncmp(arg, "max_tries=", 10) == 0) {
-            if (parse_int(eq + 1, &value) == 0) {
+            if (options_parse_int(eq + 1, &value) == 0) {
                 /* Prevent unrealistic values that weaken UX or security posture. */
                 opts->max_tries = clamp_int(value, 1, 10);
             }
@@ -115,7 +130,7 @@ void options_parse(module_options *opts, int argc, const char **argv)
         }
 
         if (strncmp(arg, "fail_delay_ms=", 14) == 0) {
-            if (parse_int(eq + 1, &value) == 0) {
+            if (options_parse_int(eq + 1, &value) == 0) {
                 opts->fail_delay_ms = clamp_int(value, 0, 10000);
             }
             continue;
@@ -138,14 +153,14 @@ void options_parse(module_options *opts, int argc, const char **argv)
         }
 
         if (strncmp(arg, "pin_min_len=", 12) == 0) {
-            if (parse_int(eq + 1, &value) == 0) {
+            if (options_parse_int(eq + 1, &value) == 0) {
                 opts->pin_min_len = clamp_int(value, 1, 32);
             }
             continue;
         }
 
         if (strncmp(arg, "pin_max_len=", 12) == 0) {
-            if (parse_int(eq + 1, &value) == 0) {
+            if (options_parse_int(eq + 1, &value) == 0) {
                 opts->pin_max_len = clamp_int(value, 1, 64);
             }
             continue;
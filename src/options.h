@@ -3,10 +3,17 @@
 
 #include <limits.h>
 
+/* Defaults shared by the module and the helper tools. */
+#define DEFAULT_PIN_DB "/etc/security/pam_pin.db"
+#define DEFAULT_RETRY_DIR "/run/pam_pin"
+
 typedef struct module_options {
     int max_tries;
     int fail_delay_ms;
     int debug;
+    int stats;
+    int profile;
+    int audit;
     int pin_min_len;
     int pin_max_len;
     char pin_db[PATH_MAX];
@@ -15,5 +22,6 @@ typedef struct module_options {
 
 void options_set_defaults(module_options *opts);
 void options_parse(module_options *opts, int argc, const char **argv);
+int options_parse_int(const char *value, int *out);
 
 #endif
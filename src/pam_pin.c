@@ -10,11 +10,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "audit_ring.h"
 #include "crypto.h"
 #include "options.h"
+#include "perf_profile.h"
 #include "pin_store.h"
+#include "probes.h"
 #include "retry_store.h"
+#include "stats.h"
 
 #define PAM_PIN_RETRY_CLEANUP_KEY "pam_pin_retry_cleanup"
 
@@ -24,6 +30,12 @@ typedef struct retry_cleanup_data {
     int debug;
 } retry_cleanup_data;
 
+typedef struct auth_result {
+    stats_outcome outcome;
+    int retry_count;
+    uint64_t prompt_us;
+} auth_result;
+
 /* Emit debug logs only when explicitly enabled. */
 static void maybe_log_debug(pam_handle_t *pamh, const module_options *opts, const char *msg)
 {
@@ -51,33 +63,114 @@ static void retry_cleanup(pam_handle_t *pamh, void *data, int pam_status)
     free(info);
 }
 
-/* Perform PIN authentication with persistent retry tracking. */
-PAM_EXTERN int pam_sm_authenticate(pam_handle_t *pamh, int flags, int argc, const char **argv)
+/* Return microseconds elapsed since a stats_monotonic_us() timestamp. */
+static uint64_t elapsed_since(uint64_t start_us)
+{
+    uint64_t now_us = stats_monotonic_us();
+
+    return (now_us > start_us) ? now_us - start_us : 0;
+}
+
+/* Copy a PAM string into a fixed-size audit field, truncating if needed. */
+static void copy_audit_field(char *dst, size_t dst_len, const char *src)
+{
+    if (src == NULL) {
+        src = "";
+    }
+    (void)strncpy(dst, src, dst_len - 1);
+    dst[dst_len - 1] = '\0';
+}
+
+/* Queue one audit record without blocking; a full ring only bumps its drop counter. */
+static void record_audit(pam_handle_t *pamh, const module_options *opts, int pam_rc,
+                         const auth_result *result, uint64_t latency_us)
+{
+    audit_ring *ring;
+    audit_record record;
+    struct timespec now;
+    const void *user = NULL;
+    const void *service = NULL;
+
+    ring = audit_ring_open(opts->retry_dir);
+    if (ring == NULL) {
+        maybe_log_debug(pamh, opts, "pam_pin: audit ring unavailable, attempt not recorded");
+        return;
+    }
+
+    memset(&record, 0, sizeof(record));
+    if (clock_gettime(CLOCK_REALTIME, &now) == 0) {
+        record.timestamp_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    }
+    record.latency_us = latency_us;
+    record.pid = (int32_t)getpid();
+    record.pam_rc = pam_rc;
+    record.outcome = (int32_t)result->outcome;
+    record.retry_count = result->retry_count;
+    /* Read PAM_USER directly: pam_get_user() would prompt again if it is still unset. */
+    if (pam_get_item(pamh, PAM_USER, &user) != PAM_SUCCESS) {
+        user = NULL;
+    }
+    if (pam_get_item(pamh, PAM_SERVICE, &service) != PAM_SUCCESS) {
+        service = NULL;
+    }
+    copy_audit_field(record.user, sizeof(record.user), (const char *)user);
+    copy_audit_field(record.service, sizeof(record.service), (const char *)service);
+
+    if (audit_ring_push(ring, &record) != 0) {
+        maybe_log_debug(pamh, opts, "pam_pin: audit ring full, attempt dropped");
+    }
+
+    audit_ring_close(ring);
+}
+
+/* Log accumulated hardware counters for each profiled phase. */
+static void log_profile(pam_handle_t *pamh, const perf_profile *prof)
+{
+    char line[512];
+    int phase;
+
+    for (phase = 0; phase < PERF_PHASE_COUNT; ++phase) {
+        if (prof->samples[phase] == 0) {
+            continue;
+        }
+        if (perf_profile_format(prof, (perf_phase_id)phase, line, sizeof(line)) == 0) {
+            pam_syslog(pamh, LOG_DEBUG, "pam_pin: profile %s", line);
+        }
+    }
+}
+
+/* Run the PIN prompt/verify flow, reporting why it stopped through result. */
+static int authenticate_pin(pam_handle_t *pamh, const module_options *opts, stats_file *stats,
+                            perf_profile *prof, auth_result *result)
 {
-    module_options opts;
     const char *user = NULL;
     const char *token = NULL;
     int pam_rc;
     int lookup_rc;
+    int read_rc;
     char *stored_hash = NULL;
     int attempt;
     int retry_count = 0;
-
-    (void)flags;
-
-    /* Load module defaults first, then override them with PAM arguments. */
-    options_set_defaults(&opts);
-    options_parse(&opts, argc, argv);
+    uint64_t phase_start;
+    uint64_t phase_us;
 
     pam_rc = pam_get_user(pamh, &user, NULL);
     if (pam_rc != PAM_SUCCESS || user == NULL || *user == '\0') {
-        maybe_log_debug(pamh, &opts, "pam_pin: no valid user, fallback to next module");
+        maybe_log_debug(pamh, opts, "pam_pin: no valid user, fallback to next module");
+        result->outcome = STATS_OUTCOME_NO_USER;
         return PAM_IGNORE;
     }
 
-    lookup_rc = pin_store_lookup_hash(opts.pin_db, user, &stored_hash);
+    perf_profile_begin(prof);
+    phase_start = stats_monotonic_us();
+    lookup_rc = pin_store_lookup_hash(opts->pin_db, user, &stored_hash);
+    phase_us = elapsed_since(phase_start);
+    perf_profile_end(prof, PERF_PHASE_DB_LOOKUP);
+    stats_record_phase(stats, STATS_PHASE_DB_LOOKUP, phase_us);
+    PAM_PIN_PROBE3(db_lookup_done, user, lookup_rc, phase_us);
     if (lookup_rc <= 0) {
-        maybe_log_debug(pamh, &opts, "pam_pin: no PIN entry or db issue, fallback to next module");
+        maybe_log_debug(pamh, opts, "pam_pin: no PIN entry or db issue, fallback to next module");
+        result->outcome = STATS_OUTCOME_NO_ENTRY;
         return PAM_IGNORE;
     }
 
@@ -86,11 +179,11 @@ PAM_EXTERN int pam_sm_authenticate(pam_handle_t *pamh, int flags, int argc, cons
         if (pam_get_data(pamh, PAM_PIN_RETRY_CLEANUP_KEY, &existing) != PAM_SUCCESS) {
             retry_cleanup_data *info = (retry_cleanup_data *)calloc(1, sizeof(*info));
             if (info != NULL) {
-                (void)strncpy(info->retry_dir, opts.retry_dir, sizeof(info->retry_dir) - 1);
+                (void)strncpy(info->retry_dir, opts->retry_dir, sizeof(info->retry_dir) - 1);
                 info->retry_dir[sizeof(info->retry_dir) - 1] = '\0';
                 (void)strncpy(info->username, user, sizeof(info->username) - 1);
                 info->username[sizeof(info->username) - 1] = '\0';
-                info->debug = opts.debug;
+                info->debug = opts->debug;
                 if (pam_set_data(pamh, PAM_PIN_RETRY_CLEANUP_KEY, info, retry_cleanup) != PAM_SUCCESS) {
                     free(info);
                 }
@@ -98,21 +191,31 @@ PAM_EXTERN int pam_sm_authenticate(pam_handle_t *pamh, int flags, int argc, cons
         }
     }
 
-    if (retry_store_read(opts.retry_dir, user, &retry_count) != 0) {
-        maybe_log_debug(pamh, &opts, "pam_pin: retry store unavailable, fallback to next module");
+    perf_profile_begin(prof);
+    phase_start = stats_monotonic_us();
+    read_rc = retry_store_read(opts->retry_dir, user, &retry_count);
+    phase_us = elapsed_since(phase_start);
+    perf_profile_end(prof, PERF_PHASE_RETRY_IO);
+    stats_record_phase(stats, STATS_PHASE_RETRY_READ, phase_us);
+    PAM_PIN_PROBE3(retry_read_done, read_rc, retry_count, phase_us);
+    result->retry_count = retry_count;
+    if (read_rc != 0) {
+        maybe_log_debug(pamh, opts, "pam_pin: retry store unavailable, fallback to next module");
         free(stored_hash);
+        result->outcome = STATS_OUTCOME_RETRY_UNAVAILABLE;
         return PAM_IGNORE;
     }
 
     {
-        int remaining = opts.max_tries - retry_count;
+        int remaining = opts->max_tries - retry_count;
         if (remaining < 0) {
             remaining = 0;
         }
 
         if (remaining == 0) {
-            maybe_log_debug(pamh, &opts, "pam_pin: retry limit reached, fallback to password");
+            maybe_log_debug(pamh, opts, "pam_pin: retry limit reached, fallback to password");
             free(stored_hash);
+            result->outcome = STATS_OUTCOME_LOCKED_OUT;
             return PAM_IGNORE;
         }
 
@@ -123,55 +226,149 @@ PAM_EXTERN int pam_sm_authenticate(pam_handle_t *pamh, int flags, int argc, cons
          */
         for (attempt = 1; attempt <= remaining; ++attempt) {
             int verified;
+            int increment_rc;
+            int clear_rc;
 
+            /* Time spent waiting for the user is tracked so it can be left out of "total". */
+            phase_start = stats_monotonic_us();
             pam_rc = pam_get_authtok(pamh, PAM_AUTHTOK, &token, "PIN or Password");
+            result->prompt_us += elapsed_since(phase_start);
             if (pam_rc != PAM_SUCCESS || token == NULL) {
-                maybe_log_debug(pamh, &opts, "pam_pin: prompt failed, fallback to next module");
+                maybe_log_debug(pamh, opts, "pam_pin: prompt failed, fallback to next module");
                 free(stored_hash);
+                result->outcome = STATS_OUTCOME_PROMPT_FAILED;
                 return PAM_IGNORE;
             }
 
-            if (!crypto_pin_format_valid(token, opts.pin_min_len, opts.pin_max_len)) {
-                maybe_log_debug(pamh, &opts, "pam_pin: non-PIN token, fallback to password module");
+            if (!crypto_pin_format_valid(token, opts->pin_min_len, opts->pin_max_len)) {
+                maybe_log_debug(pamh, opts, "pam_pin: non-PIN token, fallback to password module");
                 free(stored_hash);
+                result->outcome = STATS_OUTCOME_NON_PIN;
                 return PAM_IGNORE;
             }
 
+            PAM_PIN_PROBE1(verify_start, attempt);
+            perf_profile_begin(prof);
+            phase_start = stats_monotonic_us();
             verified = crypto_verify_pin_hash(token, stored_hash);
+            phase_us = elapsed_since(phase_start);
+            perf_profile_end(prof, PERF_PHASE_VERIFY);
+            stats_record_phase(stats, STATS_PHASE_VERIFY, phase_us);
+            PAM_PIN_PROBE3(verify_done, attempt, verified, phase_us);
 
             if (verified) {
-                maybe_log_debug(pamh, &opts, "pam_pin: PIN accepted");
-                (void)retry_store_clear(opts.retry_dir, user);
+                maybe_log_debug(pamh, opts, "pam_pin: PIN accepted");
+                perf_profile_begin(prof);
+                phase_start = stats_monotonic_us();
+                clear_rc = retry_store_clear(opts->retry_dir, user);
+                phase_us = elapsed_since(phase_start);
+                perf_profile_end(prof, PERF_PHASE_RETRY_IO);
+                stats_record_phase(stats, STATS_PHASE_RETRY_CLEAR, phase_us);
+                PAM_PIN_PROBE2(retry_clear_done, clear_rc, phase_us);
                 free(stored_hash);
+                result->outcome = STATS_OUTCOME_SUCCESS;
                 return PAM_SUCCESS;
             }
 
-            if (retry_store_increment(opts.retry_dir, user, &retry_count) != 0) {
-                maybe_log_debug(pamh, &opts, "pam_pin: failed to persist retry count, fallback to password");
+            stats_record_wrong_pin(stats);
+
+            perf_profile_begin(prof);
+            phase_start = stats_monotonic_us();
+            increment_rc = retry_store_increment(opts->retry_dir, user, &retry_count);
+            phase_us = elapsed_since(phase_start);
+            perf_profile_end(prof, PERF_PHASE_RETRY_IO);
+            stats_record_phase(stats, STATS_PHASE_RETRY_INCREMENT, phase_us);
+            PAM_PIN_PROBE3(retry_increment_done, increment_rc, retry_count, phase_us);
+            result->retry_count = retry_count;
+            if (increment_rc != 0) {
+                maybe_log_debug(pamh, opts, "pam_pin: failed to persist retry count, fallback to password");
                 free(stored_hash);
+                result->outcome = STATS_OUTCOME_RETRY_PERSIST_FAILED;
                 return PAM_IGNORE;
             }
 
             /* Clear cached authtok so a wrong PIN is not reused by downstream modules. */
             if (pam_set_item(pamh, PAM_AUTHTOK, NULL) != PAM_SUCCESS) {
                 free(stored_hash);
+                result->outcome = STATS_OUTCOME_AUTHTOK_RESET_FAILED;
                 return PAM_IGNORE;
             }
 
             /* Apply a linear backoff delay to slow down online brute-force attempts. */
-            if (opts.fail_delay_ms > 0) {
-                uint64_t delay_us64 = (uint64_t)opts.fail_delay_ms * (uint64_t)retry_count * 1000ULL;
+            if (opts->fail_delay_ms > 0) {
+                uint64_t delay_us64 = (uint64_t)opts->fail_delay_ms * (uint64_t)retry_count * 1000ULL;
                 unsigned int delay_us = (delay_us64 > (uint64_t)UINT_MAX) ? UINT_MAX : (unsigned int)delay_us64;
                 pam_fail_delay(pamh, delay_us);
             }
         }
     }
 
-    maybe_log_debug(pamh, &opts, "pam_pin: PIN attempts exceeded, fallback to password");
+    maybe_log_debug(pamh, opts, "pam_pin: PIN attempts exceeded, fallback to password");
     free(stored_hash);
+    result->outcome = STATS_OUTCOME_EXHAUSTED;
     return PAM_IGNORE;
 }
 
+/* Perform PIN authentication with persistent retry tracking. */
+PAM_EXTERN int pam_sm_authenticate(pam_handle_t *pamh, int flags, int argc, const char **argv)
+{
+    module_options opts;
+    stats_file *stats = NULL;
+    perf_profile profile;
+    perf_profile *prof = NULL;
+    auth_result result = { STATS_OUTCOME_NO_USER, 0, 0 };
+    uint64_t auth_start;
+    uint64_t total_us;
+    uint64_t module_us;
+    int rc;
+
+    (void)flags;
+
+    /* Load module defaults first, then override them with PAM arguments. */
+    options_set_defaults(&opts);
+    options_parse(&opts, argc, argv);
+
+    /* Stats are best effort: a missing or invalid stats file never blocks login. */
+    if (opts.stats) {
+        stats = stats_open(opts.retry_dir);
+        if (stats == NULL) {
+            maybe_log_debug(pamh, &opts, "pam_pin: stats file unavailable, timings not recorded");
+        }
+    }
+
+    /* Profiling degrades quietly: phases run unprofiled if no counter can be opened. */
+    if (opts.profile) {
+        if (perf_profile_open(&profile) > 0) {
+            prof = &profile;
+        } else {
+            perf_profile_close(&profile);
+            maybe_log_debug(pamh, &opts, "pam_pin: perf counters unavailable, profiling disabled");
+        }
+    }
+
+    PAM_PIN_PROBE0(auth_start);
+    auth_start = stats_monotonic_us();
+    rc = authenticate_pin(pamh, &opts, stats, prof, &result);
+    total_us = elapsed_since(auth_start);
+    /* The module's own latency: the stats total and the audit record both leave out prompt time. */
+    module_us = (total_us > result.prompt_us) ? total_us - result.prompt_us : 0;
+    stats_record_phase(stats, STATS_PHASE_TOTAL, module_us);
+    stats_record_outcome(stats, result.outcome);
+    PAM_PIN_PROBE3(auth_end, rc, (int)result.outcome, total_us);
+
+    if (opts.audit) {
+        record_audit(pamh, &opts, rc, &result, module_us);
+    }
+
+    if (prof != NULL) {
+        log_profile(pamh, prof);
+        perf_profile_close(prof);
+    }
+
+    stats_close(stats);
+    return rc;
+}
+
 /* Clear retries after a successful PAM authentication flow. */
 PAM_EXTERN int pam_sm_setcred(pam_handle_t *pamh, int flags, int argc, const char **argv)
 {
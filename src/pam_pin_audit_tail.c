@@ -0,0 +1,319 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audit_ring.h"
+#include "options.h"
+#include "retry_store.h"
+#include "stats.h"
+
+#define AUDIT_LOCK_NAME "pam_pin.audit.lock"
+#define AUDIT_BATCH_MAX 256
+#define AUDIT_STALL_TIMEOUT_MS 5000
+#define AUDIT_STALL_POLL_MS 100
+
+/* Tracks a slot the consumer has been waiting on since first_seen_ms. */
+typedef struct stall_state {
+    int active;
+    uint64_t pos;
+    uint64_t first_seen_ms;
+} stall_state;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+/* Ask the drain loop to finish its current pass and exit. */
+static void handle_stop(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+}
+
+/* Return a monotonic timestamp in milliseconds. */
+static uint64_t monotonic_ms(void)
+{
+    return stats_monotonic_us() / 1000ULL;
+}
+
+/* Take the single-consumer lock so two tails never drain the same ring. */
+static int acquire_consumer_lock(const char *retry_dir)
+{
+    int dirfd;
+    int fd;
+
+    dirfd = retry_store_open_dir(retry_dir);
+    if (dirfd < 0) {
+        return -1;
+    }
+
+    fd = openat(dirfd, AUDIT_LOCK_NAME, O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+    close(dirfd);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* Copy a fixed-size record field, replacing anything non-printable. */
+static void sanitize_field(char *dst, size_t dst_len, const char *src, size_t src_len)
+{
+    size_t i;
+
+    for (i = 0; i + 1 < dst_len && i < src_len && src[i] != '\0'; ++i) {
+        unsigned char ch = (unsigned char)src[i];
+        dst[i] = (ch > 0x20 && ch < 0x7f && ch != '"') ? (char)ch : '?';
+    }
+    dst[i] = '\0';
+}
+
+/* Format one record as a single key=value line without a trailing newline. */
+static void format_record(const audit_record *rec, char *buf, size_t buf_len)
+{
+    char user[AUDIT_USER_LEN + 1];
+    char service[AUDIT_SERVICE_LEN + 1];
+    char when[32];
+    struct tm tm;
+    time_t secs = (time_t)(rec->timestamp_ns / 1000000000ULL);
+    unsigned int millis = (unsigned int)((rec->timestamp_ns / 1000000ULL) % 1000ULL);
+
+    sanitize_field(user, sizeof(user), rec->user, sizeof(rec->user));
+    sanitize_field(service, sizeof(service), rec->service, sizeof(rec->service));
+
+    if (gmtime_r(&secs, &tm) == NULL || strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", &tm) == 0) {
+        (void)snprintf(when, sizeof(when), "%lld", (long long)secs);
+    }
+
+    (void)snprintf(buf, buf_len,
+                   "time=%s.%03uZ pid=%d service=\"%s\" user=\"%s\" outcome=%s pam_rc=%d retries=%d latency_us=%llu",
+                   when, millis, (int)rec->pid, service, user, stats_outcome_name((stats_outcome)rec->outcome),
+                   (int)rec->pam_rc, (int)rec->retry_count, (unsigned long long)rec->latency_us);
+}
+
+/* Emit a line to the output file or syslog. */
+static void emit_line(FILE *out, const char *line)
+{
+    if (out != NULL) {
+        (void)fprintf(out, "%s\n", line);
+    } else {
+        syslog(LOG_INFO, "%s", line);
+    }
+}
+
+/* Drain everything currently in the ring, reporting drops since the last drain. */
+static size_t drain_ring(audit_ring *ring, FILE *out)
+{
+    static audit_record batch[AUDIT_BATCH_MAX];
+    char line[512];
+    size_t total = 0;
+    size_t n;
+    size_t i;
+    uint64_t dropped;
+
+    while ((n = audit_ring_pop_batch(ring, batch, AUDIT_BATCH_MAX)) > 0) {
+        for (i = 0; i < n; ++i) {
+            format_record(&batch[i], line, sizeof(line));
+            emit_line(out, line);
+        }
+        total += n;
+    }
+
+    dropped = audit_ring_take_dropped(ring);
+    if (dropped > 0) {
+        (void)snprintf(line, sizeof(line), "audit ring overflow: dropped=%llu", (unsigned long long)dropped);
+        emit_line(out, line);
+    }
+
+    if (out != NULL) {
+        (void)fflush(out);
+    }
+
+    return total;
+}
+
+/*
+ * Detect a slot claimed by a producer that never published it (for example
+ * one killed mid-write) and skip it once it has blocked the consumer for
+ * AUDIT_STALL_TIMEOUT_MS. Returns 1 while a stall is pending or was just
+ * cleared, so the caller keeps polling and draining. A slot whose producer
+ * is still alive is not skipped; that is retried at the normal interval.
+ */
+static int check_stall(audit_ring *ring, FILE *out, stall_state *stall)
+{
+    char line[160];
+    uint64_t pos;
+    uint64_t now = monotonic_ms();
+
+    if (!audit_ring_stalled(ring, &pos)) {
+        stall->active = 0;
+        return 0;
+    }
+
+    if (!stall->active || stall->pos != pos) {
+        stall->active = 1;
+        stall->pos = pos;
+        stall->first_seen_ms = now;
+        return 1;
+    }
+
+    if (now - stall->first_seen_ms < AUDIT_STALL_TIMEOUT_MS) {
+        return 1;
+    }
+
+    if (audit_ring_skip(ring, pos) != 0) {
+        return 0;
+    }
+
+    (void)snprintf(line, sizeof(line), "audit ring stalled: skipped slot %llu left unpublished for %u ms",
+                   (unsigned long long)pos, (unsigned int)AUDIT_STALL_TIMEOUT_MS);
+    emit_line(out, line);
+    if (out != NULL) {
+        (void)fflush(out);
+    }
+    stall->active = 0;
+    return 1;
+}
+
+/* Print command-line help to stderr. */
+static void usage(const char *prog)
+{
+    (void)fprintf(stderr, "usage: %s [-d retry_dir] [-o output_file | -s] [-f] [-i interval_ms]\n", prog);
+    (void)fprintf(stderr, "  -d  retry directory holding %s (default %s)\n", AUDIT_FILE_NAME, DEFAULT_RETRY_DIR);
+    (void)fprintf(stderr, "  -o  append records to a file (default stdout)\n");
+    (void)fprintf(stderr, "  -s  send records to syslog (authpriv.info)\n");
+    (void)fprintf(stderr, "  -f  keep draining until SIGINT/SIGTERM\n");
+    (void)fprintf(stderr, "  -i  poll interval in follow mode (default 1000 ms)\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *retry_dir = DEFAULT_RETRY_DIR;
+    const char *output = NULL;
+    int use_syslog = 0;
+    int follow = 0;
+    int interval_ms = 1000;
+    FILE *out = stdout;
+    audit_ring *ring;
+    struct sigaction sa;
+    stall_state stall;
+    int lock_fd;
+    int out_fd;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:o:sfi:h")) != -1) {
+        switch (opt) {
+        case 'd':
+            retry_dir = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 's':
+            use_syslog = 1;
+            break;
+        case 'f':
+            follow = 1;
+            break;
+        case 'i':
+            if (options_parse_int(optarg, &interval_ms) != 0 || interval_ms < 10 || interval_ms > 60000) {
+                (void)fprintf(stderr, "%s: interval must be between 10 and 60000 ms\n", argv[0]);
+                return 2;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : 2;
+        }
+    }
+
+    if (output != NULL && use_syslog) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    lock_fd = acquire_consumer_lock(retry_dir);
+    if (lock_fd < 0) {
+        (void)fprintf(stderr, "%s: cannot lock %s/%s (another consumer running?)\n", argv[0], retry_dir,
+                      AUDIT_LOCK_NAME);
+        return 1;
+    }
+
+    ring = audit_ring_open(retry_dir);
+    if (ring == NULL) {
+        (void)fprintf(stderr, "%s: cannot open %s/%s\n", argv[0], retry_dir, AUDIT_FILE_NAME);
+        close(lock_fd);
+        return 1;
+    }
+
+    if (use_syslog) {
+        out = NULL;
+        openlog("pam_pin_audit", LOG_PID, LOG_AUTHPRIV);
+    } else if (output != NULL) {
+        /* Records name users and services: keep the log root-only like every other pam_pin file. */
+        out_fd = open(output, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC | O_NOFOLLOW, 0600);
+        out = (out_fd >= 0) ? fdopen(out_fd, "a") : NULL;
+        if (out == NULL) {
+            (void)fprintf(stderr, "%s: cannot open %s: %s\n", argv[0], output, strerror(errno));
+            if (out_fd >= 0) {
+                close(out_fd);
+            }
+            audit_ring_close(ring);
+            close(lock_fd);
+            return 1;
+        }
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop;
+    (void)sigaction(SIGINT, &sa, NULL);
+    (void)sigaction(SIGTERM, &sa, NULL);
+
+    memset(&stall, 0, sizeof(stall));
+
+    do {
+        struct timespec delay;
+        long sleep_ms = interval_ms;
+        int stalled;
+
+        (void)drain_ring(ring, out);
+        stalled = check_stall(ring, out, &stall);
+
+        /* A one-shot drain still waits out a stall so records behind it are not left behind. */
+        if ((!follow && !stalled) || stop_requested) {
+            break;
+        }
+        if (!follow || (stalled && sleep_ms > AUDIT_STALL_POLL_MS)) {
+            sleep_ms = AUDIT_STALL_POLL_MS;
+        }
+
+        delay.tv_sec = sleep_ms / 1000;
+        delay.tv_nsec = (sleep_ms % 1000) * 1000000L;
+        (void)nanosleep(&delay, NULL);
+    } while (!stop_requested);
+
+    /* Flush whatever arrived during the last sleep before exiting. */
+    if (follow) {
+        (void)drain_ring(ring, out);
+    }
+
+    if (out != NULL && out != stdout) {
+        (void)fclose(out);
+    }
+    if (use_syslog) {
+        closelog();
+    }
+    audit_ring_close(ring);
+    close(lock_fd);
+    return 0;
+}
@@ -0,0 +1,251 @@
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "options.h"
+#include "stats.h"
+
+/* Copy the shared counters once so every line of a report is from one snapshot. */
+static void snapshot_stats(const stats_file *stats, stats_file *out)
+{
+    int p;
+    int b;
+    int o;
+
+    memset(out, 0, sizeof(*out));
+
+    for (p = 0; p < STATS_PHASE_COUNT; ++p) {
+        const stats_histogram *src = &stats->phases[p];
+        stats_histogram *dst = &out->phases[p];
+
+        dst->sum_us = __atomic_load_n(&src->sum_us, __ATOMIC_RELAXED);
+        /* Derive the count from the buckets so the histogram is self-consistent. */
+        for (b = 0; b < STATS_BUCKETS; ++b) {
+            dst->buckets[b] = __atomic_load_n(&src->buckets[b], __ATOMIC_RELAXED);
+            dst->count += dst->buckets[b];
+        }
+    }
+
+    for (o = 0; o < STATS_OUTCOME_COUNT; ++o) {
+        out->outcomes[o] = __atomic_load_n(&stats->outcomes[o], __ATOMIC_RELAXED);
+    }
+    out->wrong_pins = __atomic_load_n(&stats->wrong_pins, __ATOMIC_RELAXED);
+}
+
+/* Return the inclusive upper bound in microseconds of a histogram bucket. */
+static uint64_t bucket_upper_us(int bucket)
+{
+    return 1ULL << bucket;
+}
+
+/* Format a quantile bound; the unbounded last bucket prints as "inf". */
+static const char *format_bound(uint64_t bound_us, char *buf, size_t buf_len)
+{
+    if (bound_us == UINT64_MAX) {
+        return "inf";
+    }
+    (void)snprintf(buf, buf_len, "%llu", (unsigned long long)bound_us);
+    return buf;
+}
+
+/*
+ * Estimate a quantile as the upper bound of the bucket holding its
+ * nearest-rank sample, ceil(count * q). Returns UINT64_MAX when it falls in
+ * the unbounded last bucket.
+ */
+static uint64_t quantile_us(const stats_histogram *hist, double q)
+{
+    double target;
+    uint64_t rank;
+    uint64_t seen = 0;
+    int b;
+
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    target = (double)hist->count * q;
+    rank = (uint64_t)target;
+    if ((double)rank < target) {
+        rank += 1;
+    }
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    for (b = 0; b < STATS_BUCKETS - 1; ++b) {
+        seen += hist->buckets[b];
+        if (seen >= rank) {
+            return bucket_upper_us(b);
+        }
+    }
+
+    return UINT64_MAX;
+}
+
+/* Print a human-readable summary table. */
+static void print_text(FILE *out, const stats_file *snap)
+{
+    int p;
+    int o;
+
+    (void)fprintf(out, "%-16s %10s %12s %12s %12s\n", "phase", "count", "mean_us", "p50_us<=", "p99_us<=");
+    for (p = 0; p < STATS_PHASE_COUNT; ++p) {
+        const stats_histogram *hist = &snap->phases[p];
+        uint64_t mean = hist->count ? hist->sum_us / hist->count : 0;
+        char p50[24];
+        char p99[24];
+
+        (void)fprintf(out, "%-16s %10llu %12llu %12s %12s\n", stats_phase_name((stats_phase)p),
+                      (unsigned long long)hist->count, (unsigned long long)mean,
+                      format_bound(quantile_us(hist, 0.50), p50, sizeof(p50)),
+                      format_bound(quantile_us(hist, 0.99), p99, sizeof(p99)));
+    }
+
+    (void)fprintf(out, "\n%-22s %10s\n", "outcome", "count");
+    for (o = 0; o < STATS_OUTCOME_COUNT; ++o) {
+        (void)fprintf(out, "%-22s %10llu\n", stats_outcome_name((stats_outcome)o),
+                      (unsigned long long)snap->outcomes[o]);
+    }
+    (void)fprintf(out, "%-22s %10llu\n", "wrong_pin_attempts", (unsigned long long)snap->wrong_pins);
+}
+
+/* Print the snapshot in Prometheus text exposition format. */
+static void print_prometheus(FILE *out, const stats_file *snap)
+{
+    int p;
+    int b;
+    int o;
+
+    (void)fprintf(out, "# HELP pam_pin_phase_duration_seconds Time spent in each pam_pin authentication phase.\n");
+    (void)fprintf(out, "# TYPE pam_pin_phase_duration_seconds histogram\n");
+    for (p = 0; p < STATS_PHASE_COUNT; ++p) {
+        const stats_histogram *hist = &snap->phases[p];
+        const char *name = stats_phase_name((stats_phase)p);
+        uint64_t cumulative = 0;
+
+        /* The last bucket has no finite upper bound, so it only appears in +Inf. */
+        for (b = 0; b < STATS_BUCKETS - 1; ++b) {
+            cumulative += hist->buckets[b];
+            (void)fprintf(out, "pam_pin_phase_duration_seconds_bucket{phase=\"%s\",le=\"%.6f\"} %llu\n", name,
+                          (double)bucket_upper_us(b) / 1e6, (unsigned long long)cumulative);
+        }
+        (void)fprintf(out, "pam_pin_phase_duration_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %llu\n", name,
+                      (unsigned long long)hist->count);
+        (void)fprintf(out, "pam_pin_phase_duration_seconds_sum{phase=\"%s\"} %.6f\n", name,
+                      (double)hist->sum_us / 1e6);
+        (void)fprintf(out, "pam_pin_phase_duration_seconds_count{phase=\"%s\"} %llu\n", name,
+                      (unsigned long long)hist->count);
+    }
+
+    (void)fprintf(out, "# HELP pam_pin_auth_outcomes_total pam_sm_authenticate calls by final outcome.\n");
+    (void)fprintf(out, "# TYPE pam_pin_auth_outcomes_total counter\n");
+    for (o = 0; o < STATS_OUTCOME_COUNT; ++o) {
+        (void)fprintf(out, "pam_pin_auth_outcomes_total{outcome=\"%s\"} %llu\n",
+                      stats_outcome_name((stats_outcome)o), (unsigned long long)snap->outcomes[o]);
+    }
+
+    (void)fprintf(out, "# HELP pam_pin_wrong_pin_attempts_total Rejected PIN attempts.\n");
+    (void)fprintf(out, "# TYPE pam_pin_wrong_pin_attempts_total counter\n");
+    (void)fprintf(out, "pam_pin_wrong_pin_attempts_total %llu\n", (unsigned long long)snap->wrong_pins);
+}
+
+/* Write the report to path via a temporary file so collectors never see a partial file. */
+static int write_report_file(const char *path, const stats_file *snap, int prometheus)
+{
+    char tmp_path[PATH_MAX];
+    FILE *out;
+    int len;
+
+    len = snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    if (len <= 0 || (size_t)len >= sizeof(tmp_path)) {
+        return -1;
+    }
+
+    out = fopen(tmp_path, "we");
+    if (out == NULL) {
+        return -1;
+    }
+
+    if (prometheus) {
+        print_prometheus(out, snap);
+    } else {
+        print_text(out, snap);
+    }
+
+    if (fclose(out) != 0) {
+        (void)unlink(tmp_path);
+        return -1;
+    }
+
+    if (rename(tmp_path, path) != 0) {
+        (void)unlink(tmp_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Print command-line help to stderr. */
+static void usage(const char *prog)
+{
+    (void)fprintf(stderr, "usage: %s [-d retry_dir] [-p] [-o output_file]\n", prog);
+    (void)fprintf(stderr, "  -d  retry directory holding %s (default %s)\n", STATS_FILE_NAME, DEFAULT_RETRY_DIR);
+    (void)fprintf(stderr, "  -p  emit Prometheus text exposition format\n");
+    (void)fprintf(stderr, "  -o  write atomically to a file instead of stdout\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *retry_dir = DEFAULT_RETRY_DIR;
+    const char *output = NULL;
+    int prometheus = 0;
+    stats_file *stats;
+    stats_file snap;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:po:h")) != -1) {
+        switch (opt) {
+        case 'd':
+            retry_dir = optarg;
+            break;
+        case 'p':
+            prometheus = 1;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : 2;
+        }
+    }
+
+    stats = stats_open_readonly(retry_dir);
+    if (stats == NULL) {
+        (void)fprintf(stderr, "%s: cannot open %s/%s\n", argv[0], retry_dir, STATS_FILE_NAME);
+        return 1;
+    }
+
+    snapshot_stats(stats, &snap);
+    stats_close(stats);
+
+    if (output != NULL) {
+        if (write_report_file(output, &snap, prometheus) != 0) {
+            (void)fprintf(stderr, "%s: cannot write %s\n", argv[0], output);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (prometheus) {
+        print_prometheus(stdout, &snap);
+    } else {
+        print_text(stdout, &snap);
+    }
+
+    return 0;
+}
@@ -0,0 +1,295 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "audit_ring.h"
+#include "crypto.h"
+#include "file_check.h"
+#include "options.h"
+#include "retry_store.h"
+#include "stats.h"
+
+#define WARMUP_MAX_PREFIXES 16
+#define WARMUP_PREFIX_LEN 16
+#define WARMUP_DUMMY_PIN "0000"
+
+typedef struct hash_prefix {
+    char prefix[WARMUP_PREFIX_LEN];
+    char *setting;
+} hash_prefix;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+/* Ask the -m resident loop to unlock and exit. */
+static void handle_stop(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+}
+
+/* Create and validate retry_dir, then pre-create the shared files the module was configured to use. */
+static int warm_retry_dir(const char *prog, const char *retry_dir, int with_stats, int with_audit)
+{
+    stats_file *stats;
+    audit_ring *ring;
+    int dirfd;
+
+    dirfd = retry_store_open_dir(retry_dir);
+    if (dirfd < 0) {
+        (void)fprintf(stderr, "%s: %s is missing, not a root-owned directory, or accessible by group/other\n",
+                      prog, retry_dir);
+        return -1;
+    }
+    close(dirfd);
+
+    /* Sizing and initializing these on first login would add to its latency. */
+    if (with_stats) {
+        stats = stats_open(retry_dir);
+        if (stats == NULL) {
+            (void)fprintf(stderr, "%s: cannot create or validate %s/%s (stale file with another layout?)\n",
+                          prog, retry_dir, STATS_FILE_NAME);
+            return -1;
+        }
+        stats_close(stats);
+    }
+    if (with_audit) {
+        ring = audit_ring_open(retry_dir);
+        if (ring == NULL) {
+            (void)fprintf(stderr, "%s: cannot create or validate %s/%s (stale file with another layout?)\n",
+                          prog, retry_dir, AUDIT_FILE_NAME);
+            return -1;
+        }
+        audit_ring_close(ring);
+    }
+    return 0;
+}
+
+/* Extract the crypt(3) algorithm prefix ("$y$", "$6$", "$2b$", or "" for DES). */
+static void hash_prefix_of(const char *hash, char *out, size_t out_len)
+{
+    const char *end;
+    size_t len = 0;
+
+    if (hash[0] == '$') {
+        end = strchr(hash + 1, '$');
+        if (end != NULL) {
+            len = (size_t)(end - hash) + 1;
+        }
+    }
+
+    if (len >= out_len) {
+        len = 0;
+    }
+    memcpy(out, hash, len);
+    out[len] = '\0';
+}
+
+/* Remember the first hash seen for each distinct algorithm prefix. */
+static void collect_prefixes(const char *data, size_t size, hash_prefix *prefixes, int *count)
+{
+    const char *line = data;
+    const char *end = data + size;
+
+    while (line < end) {
+        const char *eol = memchr(line, '\n', (size_t)(end - line));
+        const char *sep;
+        size_t len;
+        char hash[512];
+        char prefix[WARMUP_PREFIX_LEN];
+        int i;
+
+        if (eol == NULL) {
+            eol = end;
+        }
+        len = (size_t)(eol - line);
+
+        sep = memchr(line, ':', len);
+        if (line[0] != '#' && sep != NULL && (size_t)(eol - sep - 1) < sizeof(hash)) {
+            size_t hash_len = (size_t)(eol - sep - 1);
+
+            memcpy(hash, sep + 1, hash_len);
+            hash[hash_len] = '\0';
+            while (hash_len > 0 && (hash[hash_len - 1] == '\r' || hash[hash_len - 1] == ' ' ||
+                                    hash[hash_len - 1] == '\t')) {
+                hash[--hash_len] = '\0';
+            }
+
+            if (hash_len > 0) {
+                hash_prefix_of(hash, prefix, sizeof(prefix));
+                for (i = 0; i < *count; ++i) {
+                    if (strcmp(prefixes[i].prefix, prefix) == 0) {
+                        break;
+                    }
+                }
+                if (i == *count && *count < WARMUP_MAX_PREFIXES) {
+                    prefixes[i].setting = strdup(hash);
+                    if (prefixes[i].setting != NULL) {
+                        (void)strncpy(prefixes[i].prefix, prefix, sizeof(prefixes[i].prefix) - 1);
+                        prefixes[i].prefix[sizeof(prefixes[i].prefix) - 1] = '\0';
+                        *count += 1;
+                    }
+                }
+            }
+            crypto_secure_bzero(hash, sizeof(hash));
+        }
+
+        line = eol + 1;
+    }
+}
+
+/*
+ * Pre-fault the PIN DB into the page cache and hash a dummy PIN once per
+ * algorithm, so libcrypt's code and the hash's memory cost are paid now
+ * rather than at the greeter. The mapping is returned for optional mlock.
+ */
+static int warm_pin_db(const char *prog, const char *pin_db, void **map_out, size_t *size_out)
+{
+    hash_prefix prefixes[WARMUP_MAX_PREFIXES];
+    struct stat st;
+    void *map;
+    int count = 0;
+    int fd;
+    int i;
+
+    *map_out = NULL;
+    *size_out = 0;
+
+    fd = open(pin_db, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) {
+        (void)fprintf(stderr, "%s: cannot open %s: %s\n", prog, pin_db, strerror(errno));
+        return -1;
+    }
+
+    if (file_check_root_only(fd, &st) != 0) {
+        (void)fprintf(stderr, "%s: %s must be a root-owned regular file with mode 0600\n", prog, pin_db);
+        close(fd);
+        return -1;
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        (void)fprintf(stderr, "%s: cannot map %s: %s\n", prog, pin_db, strerror(errno));
+        return -1;
+    }
+
+    memset(prefixes, 0, sizeof(prefixes));
+    collect_prefixes((const char *)map, (size_t)st.st_size, prefixes, &count);
+
+    for (i = 0; i < count; ++i) {
+        (void)crypto_verify_pin_hash(WARMUP_DUMMY_PIN, prefixes[i].setting);
+        crypto_secure_bzero(prefixes[i].setting, strlen(prefixes[i].setting));
+        free(prefixes[i].setting);
+    }
+
+    *map_out = map;
+    *size_out = (size_t)st.st_size;
+    return count;
+}
+
+/* Print command-line help to stderr. */
+static void usage(const char *prog)
+{
+    (void)fprintf(stderr, "usage: %s [-d retry_dir] [-p pin_db] [-s] [-a] [-m]\n", prog);
+    (void)fprintf(stderr, "  -d  retry directory to create and validate (default %s)\n", DEFAULT_RETRY_DIR);
+    (void)fprintf(stderr, "  -p  PIN database to pre-fault (default %s)\n", DEFAULT_PIN_DB);
+    (void)fprintf(stderr, "  -s  pre-create %s (only when the module uses the stats option)\n", STATS_FILE_NAME);
+    (void)fprintf(stderr, "  -a  pre-create %s (only when the module uses the audit option)\n", AUDIT_FILE_NAME);
+    (void)fprintf(stderr, "  -m  mlock the PIN database and stay resident until SIGTERM\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *retry_dir = DEFAULT_RETRY_DIR;
+    const char *pin_db = DEFAULT_PIN_DB;
+    int with_stats = 0;
+    int with_audit = 0;
+    int lock_db = 0;
+    void *map = NULL;
+    size_t map_size = 0;
+    struct sigaction sa;
+    int algorithms;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:p:samh")) != -1) {
+        switch (opt) {
+        case 'd':
+            retry_dir = optarg;
+            break;
+        case 'p':
+            pin_db = optarg;
+            break;
+        case 's':
+            with_stats = 1;
+            break;
+        case 'a':
+            with_audit = 1;
+            break;
+        case 'm':
+            lock_db = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : 2;
+        }
+    }
+
+    if (retry_dir[0] != '/' || pin_db[0] != '/') {
+        (void)fprintf(stderr, "%s: paths must be absolute\n", argv[0]);
+        return 2;
+    }
+
+    /* Match the module: retry files must never be created group/other accessible. */
+    (void)umask(077);
+
+    if (warm_retry_dir(argv[0], retry_dir, with_stats, with_audit) != 0) {
+        return 1;
+    }
+
+    algorithms = warm_pin_db(argv[0], pin_db, &map, &map_size);
+    if (algorithms < 0) {
+        return 1;
+    }
+
+    (void)printf("%s: %s ready, %d hash algorithm(s) warmed from %s\n", argv[0], retry_dir, algorithms, pin_db);
+    (void)fflush(stdout);
+
+    if (!lock_db || map == NULL) {
+        if (map != NULL) {
+            (void)munmap(map, map_size);
+        }
+        return 0;
+    }
+
+    if (mlock(map, map_size) != 0) {
+        (void)fprintf(stderr, "%s: cannot mlock %s: %s\n", argv[0], pin_db, strerror(errno));
+        (void)munmap(map, map_size);
+        return 1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop;
+    (void)sigaction(SIGINT, &sa, NULL);
+    (void)sigaction(SIGTERM, &sa, NULL);
+
+    /* The lock only lasts while this process holds the mapping. */
+    while (!stop_requested) {
+        (void)pause();
+    }
+
+    (void)munlock(map, map_size);
+    (void)munmap(map, map_size);
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include "perf_profile.h"
+
+#include <linux/perf_event.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define PERF_READ_FORMAT (PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING)
+
+typedef struct perf_counter_spec {
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+} perf_counter_spec;
+
+static const perf_counter_spec counter_specs[PERF_COUNTER_COUNT] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache_misses" },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, "page_faults" },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context_switches" },
+};
+
+static const char *const phase_names[PERF_PHASE_COUNT] = {
+    "db_lookup",
+    "retry_io",
+    "verify",
+};
+
+/* Open one counting event for the calling thread on any CPU, optionally in a group. */
+static int open_counter(const perf_counter_spec *spec, int exclude_kernel, int group_fd, uint64_t read_format)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = spec->type;
+    attr.config = spec->config;
+    attr.read_format = read_format;
+    attr.exclude_kernel = exclude_kernel ? 1 : 0;
+    attr.exclude_hv = 1;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+/*
+ * Open a counter, preferring to count kernel work too (page faults, crypt
+ * syscalls) but falling back to user-only counting under a strict
+ * perf_event_paranoid. Group members follow the leader's choice.
+ */
+static int open_with_fallback(perf_profile *prof, int id, int group_fd, uint64_t read_format, int force_user)
+{
+    int fd = -1;
+
+    if (!force_user) {
+        fd = open_counter(&counter_specs[id], 0, group_fd, read_format);
+    }
+    if (fd < 0) {
+        fd = open_counter(&counter_specs[id], 1, group_fd, read_format);
+        prof->user_only[id] = (fd >= 0);
+    }
+    return fd;
+}
+
+/* Read all counters at once: the hardware group in one read, software events individually. */
+static void read_all(const perf_profile *prof, perf_reading *out)
+{
+    uint64_t buf[3 + PERF_COUNTER_COUNT];
+    int i;
+
+    memset(out, 0, sizeof(*out) * PERF_COUNTER_COUNT);
+
+    if (prof->group_leader >= 0) {
+        ssize_t want = (ssize_t)((3 + (size_t)prof->group_size) * sizeof(uint64_t));
+
+        /* Group layout: nr, time_enabled, time_running, then one value per member. */
+        if (read(prof->group_leader, buf, (size_t)want) == want && buf[0] == (uint64_t)prof->group_size) {
+            for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+                if (prof->group_slot[i] >= 0) {
+                    out[i].value = buf[3 + prof->group_slot[i]];
+                    out[i].time_enabled = buf[1];
+                    out[i].time_running = buf[2];
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (prof->fds[i] >= 0 && prof->group_slot[i] < 0) {
+            if (read(prof->fds[i], buf, 3 * sizeof(uint64_t)) == (ssize_t)(3 * sizeof(uint64_t))) {
+                out[i].value = buf[0];
+                out[i].time_enabled = buf[1];
+                out[i].time_running = buf[2];
+            }
+        }
+    }
+}
+
+/* Open every counter the kernel allows. Returns the number that opened. */
+int perf_profile_open(perf_profile *prof)
+{
+    int i;
+    int opened = 0;
+    int leader_user_only = 0;
+
+    memset(prof, 0, sizeof(*prof));
+    prof->group_leader = -1;
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        prof->fds[i] = -1;
+        prof->group_slot[i] = -1;
+    }
+
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (counter_specs[i].type == PERF_TYPE_HARDWARE) {
+            /* The first hardware event that opens leads the group; the rest join it. */
+            prof->fds[i] = open_with_fallback(prof, i, prof->group_leader, PERF_READ_FORMAT | PERF_FORMAT_GROUP,
+                                              prof->group_leader >= 0 && leader_user_only);
+            if (prof->fds[i] >= 0) {
+                if (prof->group_leader < 0) {
+                    prof->group_leader = prof->fds[i];
+                    leader_user_only = prof->user_only[i];
+                }
+                prof->group_slot[i] = prof->group_size++;
+            }
+        } else {
+            prof->fds[i] = open_with_fallback(prof, i, -1, PERF_READ_FORMAT, 0);
+        }
+
+        if (prof->fds[i] >= 0) {
+            ++opened;
+        }
+    }
+
+    return opened;
+}
+
+/* Close all counters opened by perf_profile_open(). */
+void perf_profile_close(perf_profile *prof)
+{
+    int i;
+
+    if (prof == NULL) {
+        return;
+    }
+
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (prof->fds[i] >= 0) {
+            close(prof->fds[i]);
+        }
+        prof->fds[i] = -1;
+    }
+    prof->group_leader = -1;
+}
+
+/* Snapshot all counters at the start of a phase. NULL is accepted. */
+void perf_profile_begin(perf_profile *prof)
+{
+    if (prof == NULL) {
+        return;
+    }
+
+    read_all(prof, prof->start);
+}
+
+/* Add the scaled counter deltas since perf_profile_begin() to a phase. NULL is accepted. */
+void perf_profile_end(perf_profile *prof, perf_phase_id phase)
+{
+    perf_reading now[PERF_COUNTER_COUNT];
+    int i;
+
+    if (prof == NULL || (int)phase < 0 || (int)phase >= PERF_PHASE_COUNT) {
+        return;
+    }
+
+    read_all(prof, now);
+
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        uint64_t value;
+        uint64_t enabled;
+        uint64_t running;
+
+        if (prof->fds[i] < 0 || now[i].value < prof->start[i].value) {
+            continue;
+        }
+
+        value = now[i].value - prof->start[i].value;
+        enabled = now[i].time_enabled - prof->start[i].time_enabled;
+        running = now[i].time_running - prof->start[i].time_running;
+
+        /* Extrapolate when the PMU only counted for part of the phase. */
+        if (running < enabled) {
+            prof->multiplexed[phase] += 1;
+            if (running > 0) {
+                value = (uint64_t)((double)value * (double)enabled / (double)running);
+            }
+        }
+        prof->totals[phase][i] += value;
+    }
+    prof->samples[phase] += 1;
+}
+
+/*
+ * Format one phase as "phase n=... cycles=... ..." for the debug log.
+ * "(u)" marks user-space-only counters; "multiplexed=" counts scaled readings.
+ */
+int perf_profile_format(const perf_profile *prof, perf_phase_id phase, char *buf, size_t buf_len)
+{
+    size_t used;
+    int len;
+    int i;
+
+    if (prof == NULL || buf == NULL || (int)phase < 0 || (int)phase >= PERF_PHASE_COUNT) {
+        return -1;
+    }
+
+    len = snprintf(buf, buf_len, "%s n=%u", phase_names[phase], prof->samples[phase]);
+    if (len < 0 || (size_t)len >= buf_len) {
+        return -1;
+    }
+    used = (size_t)len;
+
+    for (i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        const char *scope = prof->user_only[i] ? "(u)" : "";
+
+        if (prof->fds[i] >= 0) {
+            len = snprintf(buf + used, buf_len - used, " %s%s=%llu", counter_specs[i].name, scope,
+                           (unsigned long long)prof->totals[phase][i]);
+        } else {
+            len = snprintf(buf + used, buf_len - used, " %s=n/a", counter_specs[i].name);
+        }
+        if (len < 0 || (size_t)len >= buf_len - used) {
+            return -1;
+        }
+        used += (size_t)len;
+    }
+
+    if (prof->multiplexed[phase] > 0) {
+        len = snprintf(buf + used, buf_len - used, " multiplexed=%u", prof->multiplexed[phase]);
+        if (len < 0 || (size_t)len >= buf_len - used) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+#ifndef PAM_PIN_PERF_PROFILE_H
+#define PAM_PIN_PERF_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum perf_counter_id {
+    PERF_COUNTER_CYCLES = 0,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_CACHE_MISSES,
+    PERF_COUNTER_PAGE_FAULTS,
+    PERF_COUNTER_CONTEXT_SWITCHES,
+    PERF_COUNTER_COUNT
+} perf_counter_id;
+
+typedef enum perf_phase_id {
+    PERF_PHASE_DB_LOOKUP = 0,
+    PERF_PHASE_RETRY_IO,
+    PERF_PHASE_VERIFY,
+    PERF_PHASE_COUNT
+} perf_phase_id;
+
+/* Raw counter value with the kernel's enabled/running times for scaling. */
+typedef struct perf_reading {
+    uint64_t value;
+    uint64_t time_enabled;
+    uint64_t time_running;
+} perf_reading;
+
+/*
+ * Per-thread counters accumulated per authentication phase. Hardware events
+ * share one group so they are scheduled on the PMU together, and every
+ * reading is scaled by time_enabled/time_running when the PMU multiplexes.
+ * Counters the kernel refuses to open keep fd -1 and are reported as n/a.
+ */
+typedef struct perf_profile {
+    int fds[PERF_COUNTER_COUNT];
+    int group_slot[PERF_COUNTER_COUNT];
+    int user_only[PERF_COUNTER_COUNT];
+    int group_leader;
+    int group_size;
+    perf_reading start[PERF_COUNTER_COUNT];
+    uint64_t totals[PERF_PHASE_COUNT][PERF_COUNTER_COUNT];
+    unsigned int samples[PERF_PHASE_COUNT];
+    unsigned int multiplexed[PERF_PHASE_COUNT];
+} perf_profile;
+
+int perf_profile_open(perf_profile *prof);
+void perf_profile_close(perf_profile *prof);
+void perf_profile_begin(perf_profile *prof);
+void perf_profile_end(perf_profile *prof, perf_phase_id phase);
+int perf_profile_format(const perf_profile *prof, perf_phase_id phase, char *buf, size_t buf_len);
+
+#endif
@@ -10,35 +10,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 
-#define PIN_DB_MAX_LINE 4096
-
-/* Ensure the PIN database is a secure, root-owned regular file. */
-static int db_permissions_ok(int fd)
-{
-    struct stat st;
-
-    /*
-     * The PIN database must be a root-owned regular file with no group/other
-     * permissions, to avoid tampering or hash disclosure.
-     */
-    if (fstat(fd, &st) != 0) {
-        return -1;
-    }
-
-    if (!S_ISREG(st.st_mode)) {
-        return -1;
-    }
+#include "file_check.h"
 
-    if (st.st_uid != 0) {
-        return -1;
-    }
-
-    if ((st.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
-        return -1;
-    }
-
-    return 0;
-}
+#define PIN_DB_MAX_LINE 4096
 
 /* Strip trailing whitespace from a buffer in place. */
 static void trim_trailing_whitespace(char *s)
@@ -81,7 +55,8 @@ int pin_store_lookup_hash(const char *db_path, const char *username, char **hash
         return -1;
     }
 
-    if (db_permissions_ok(fd) != 0) {
+    /* The PIN database must be root-only to avoid tampering or hash disclosure. */
+    if (file_check_root_only(fd, NULL) != 0) {
         close(fd);
         return -1;
     }
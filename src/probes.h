@@ -0,0 +1,29 @@
+#ifndef PAM_PIN_PROBES_H
+#define PAM_PIN_PROBES_H
+
+/*
+ * USDT tracepoints under the "pam_pin" provider. With <sys/sdt.h> each probe
+ * compiles to a single nop plus an ELF note, so it costs nothing until a
+ * tracer (bpftrace, perf, SystemTap) attaches. Build with USDT=0, or without
+ * the systemtap SDT headers installed, to compile them out entirely.
+ */
+#if !defined(PAM_PIN_NO_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PAM_PIN_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef PAM_PIN_HAVE_USDT
+#define PAM_PIN_PROBE0(name) DTRACE_PROBE(pam_pin, name)
+#define PAM_PIN_PROBE1(name, a1) DTRACE_PROBE1(pam_pin, name, a1)
+#define PAM_PIN_PROBE2(name, a1, a2) DTRACE_PROBE2(pam_pin, name, a1, a2)
+#define PAM_PIN_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(pam_pin, name, a1, a2, a3)
+#else
+#define PAM_PIN_PROBE0(name) do { } while (0)
+#define PAM_PIN_PROBE1(name, a1) do { (void)(a1); } while (0)
+#define PAM_PIN_PROBE2(name, a1, a2) do { (void)(a1); (void)(a2); } while (0)
+#define PAM_PIN_PROBE3(name, a1, a2, a3) do { (void)(a1); (void)(a2); (void)(a3); } while (0)
+#endif
+
+#endif
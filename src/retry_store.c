@@ -11,19 +11,19 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "file_check.h"
+#include "probes.h"
+
 #define RETRY_COUNT_MAX 1000000
 
-/* Create or validate the retry directory with strict permissions. */
-static int open_retry_dir(const char *retry_dir)
+/* Open an existing retry directory and validate its permissions without creating it. */
+int retry_store_open_existing_dir(const char *retry_dir)
 {
     struct stat st;
     int dirfd;
 
     if (retry_dir == NULL || *retry_dir == '\0') {
-        return -1;
-    }
-
-    if (mkdir(retry_dir, 0700) != 0 && errno != EEXIST) {
+        errno = EINVAL;
         return -1;
     }
 
@@ -37,19 +37,30 @@ static int open_retry_dir(const char *retry_dir)
         return -1;
     }
 
-    if (!S_ISDIR(st.st_mode)) {
+    if (!S_ISDIR(st.st_mode) || st.st_uid != 0 || (st.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
         close(dirfd);
+        errno = EPERM;
         return -1;
     }
 
-    if (st.st_uid != 0) {
-        close(dirfd);
-        return -1;
-    }
+    return dirfd;
+}
 
-    if ((st.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
-        close(dirfd);
-        return -1;
+/* Create or validate the retry directory with strict permissions. */
+int retry_store_open_dir(const char *retry_dir)
+{
+    int dirfd;
+
+    /*
+     * A directory pre-created by pam_pin_warmup opens directly; only fall back
+     * to mkdir when it is missing, so the common path is a single open().
+     */
+    dirfd = retry_store_open_existing_dir(retry_dir);
+    if (dirfd < 0 && errno == ENOENT) {
+        if (mkdir(retry_dir, 0700) != 0 && errno != EEXIST) {
+            return -1;
+        }
+        dirfd = retry_store_open_existing_dir(retry_dir);
     }
 
     return dirfd;
@@ -199,36 +210,13 @@ static int write_count_locked(int fd, int count)
     return 0;
 }
 
-/* Validate that a retry file has secure ownership and mode. */
-static int file_permissions_ok(int fd)
-{
-    struct stat st;
-
-    if (fstat(fd, &st) != 0) {
-        return -1;
-    }
-
-    if (!S_ISREG(st.st_mode)) {
-        return -1;
-    }
-
-    if (st.st_uid != 0) {
-        return -1;
-    }
-
-    if ((st.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
-        return -1;
-    }
-
-    return 0;
-}
-
 /* Read the persisted retry count for a user. */
 int retry_store_read(const char *retry_dir, const char *username, int *count_out)
 {
     char name[300];
     int dirfd;
     int fd;
+    int lock_rc;
     int count = 0;
     int result = 0;
 
@@ -238,7 +226,7 @@ int retry_store_read(const char *retry_dir, const char *username, int *count_out
 
     *count_out = 0;
 
-    dirfd = open_retry_dir(retry_dir);
+    dirfd = retry_store_open_dir(retry_dir);
     if (dirfd < 0) {
         return -1;
     }
@@ -258,13 +246,16 @@ int retry_store_read(const char *retry_dir, const char *username, int *count_out
         return -1;
     }
 
-    if (flock(fd, LOCK_SH) != 0) {
+    PAM_PIN_PROBE1(retry_lock_wait, LOCK_SH);
+    lock_rc = flock(fd, LOCK_SH);
+    PAM_PIN_PROBE2(retry_lock_acquired, LOCK_SH, lock_rc);
+    if (lock_rc != 0) {
         close(fd);
         close(dirfd);
         return -1;
     }
 
-    if (file_permissions_ok(fd) != 0) {
+    if (file_check_root_only(fd, NULL) != 0) {
         result = -1;
     } else if (read_count_locked(fd, &count) != 0) {
         result = -1;
@@ -284,6 +275,7 @@ int retry_store_increment(const char *retry_dir, const char *username, int *coun
     char name[300];
     int dirfd;
     int fd;
+    int lock_rc;
     int count = 0;
     int result = 0;
 
@@ -293,7 +285,7 @@ int retry_store_increment(const char *retry_dir, const char *username, int *coun
 
     *count_out = 0;
 
-    dirfd = open_retry_dir(retry_dir);
+    dirfd = retry_store_open_dir(retry_dir);
     if (dirfd < 0) {
         return -1;
     }
@@ -309,13 +301,16 @@ int retry_store_increment(const char *retry_dir, const char *username, int *coun
         return -1;
     }
 
-    if (flock(fd, LOCK_EX) != 0) {
+    PAM_PIN_PROBE1(retry_lock_wait, LOCK_EX);
+    lock_rc = flock(fd, LOCK_EX);
+    PAM_PIN_PROBE2(retry_lock_acquired, LOCK_EX, lock_rc);
+    if (lock_rc != 0) {
         close(fd);
         close(dirfd);
         return -1;
     }
 
-    if (file_permissions_ok(fd) != 0) {
+    if (file_check_root_only(fd, NULL) != 0) {
         result = -1;
     } else if (read_count_locked(fd, &count) != 0) {
         result = -1;
@@ -342,7 +337,7 @@ int retry_store_clear(const char *retry_dir, const char *username)
     char name[300];
     int dirfd;
 
-    dirfd = open_retry_dir(retry_dir);
+    dirfd = retry_store_open_dir(retry_dir);
     if (dirfd < 0) {
         return -1;
     }
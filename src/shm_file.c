@@ -0,0 +1,115 @@
+#include "shm_file.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "file_check.h"
+#include "retry_store.h"
+
+/* Size and initialize a fresh shared file while holding an exclusive lock. */
+static void *shm_init_locked(int fd, size_t size, shm_file_check_fn check, shm_file_init_fn init)
+{
+    struct stat st;
+    void *base;
+
+    if (flock(fd, LOCK_EX) != 0) {
+        return NULL;
+    }
+
+    /* Re-check under the lock: another process may have initialized it already. */
+    if (file_check_root_only(fd, &st) != 0) {
+        (void)flock(fd, LOCK_UN);
+        return NULL;
+    }
+
+    if (st.st_size == 0 && ftruncate(fd, (off_t)size) != 0) {
+        (void)flock(fd, LOCK_UN);
+        return NULL;
+    }
+
+    if (st.st_size != 0 && st.st_size != (off_t)size) {
+        (void)flock(fd, LOCK_UN);
+        return NULL;
+    }
+
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        (void)flock(fd, LOCK_UN);
+        return NULL;
+    }
+
+    if (__atomic_load_n((const uint32_t *)base, __ATOMIC_ACQUIRE) == 0) {
+        init(base);
+    }
+
+    (void)flock(fd, LOCK_UN);
+
+    if (!check(base)) {
+        (void)munmap(base, size);
+        return NULL;
+    }
+
+    return base;
+}
+
+/* Map a root-only shared file under retry_dir, creating it when writable. */
+void *shm_file_map(const char *retry_dir, const char *name, size_t size, int writable,
+                   shm_file_check_fn check, shm_file_init_fn init)
+{
+    struct stat st;
+    void *base = NULL;
+    int dirfd;
+    int fd;
+    int flags = writable ? (O_RDWR | O_CREAT) : O_RDONLY;
+
+    /* Readers only validate: reporting must never create retry_dir as a side effect. */
+    dirfd = writable ? retry_store_open_dir(retry_dir) : retry_store_open_existing_dir(retry_dir);
+    if (dirfd < 0) {
+        return NULL;
+    }
+
+    fd = openat(dirfd, name, flags | O_NOFOLLOW | O_CLOEXEC, 0600);
+    close(dirfd);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (file_check_root_only(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    /* Fast path: an initialized file of the expected size needs no locking. */
+    if (st.st_size == (off_t)size) {
+        base = mmap(NULL, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            base = NULL;
+        } else if (!check(base)) {
+            (void)munmap(base, size);
+            base = NULL;
+        } else {
+            close(fd);
+            return base;
+        }
+    }
+
+    if (writable) {
+        base = shm_init_locked(fd, size, check, init);
+    }
+
+    close(fd);
+    return base;
+}
+
+/* Unmap a file returned by shm_file_map(). NULL is accepted. */
+void shm_file_unmap(void *base, size_t size)
+{
+    if (base != NULL) {
+        (void)munmap(base, size);
+    }
+}
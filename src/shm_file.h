@@ -0,0 +1,18 @@
+#ifndef PAM_PIN_SHM_FILE_H
+#define PAM_PIN_SHM_FILE_H
+
+#include <stddef.h>
+
+/*
+ * Shared files under retry_dir start with a uint32_t magic that is zero until
+ * initialization completes. check() validates a mapped header, init() fills in
+ * a zeroed file and must publish the magic last.
+ */
+typedef int (*shm_file_check_fn)(const void *base);
+typedef void (*shm_file_init_fn)(void *base);
+
+void *shm_file_map(const char *retry_dir, const char *name, size_t size, int writable,
+                   shm_file_check_fn check, shm_file_init_fn init);
+void shm_file_unmap(void *base, size_t size);
+
+#endif
@@ -0,0 +1,144 @@
+#include "stats.h"
+
+#include <stddef.h>
+#include <time.h>
+
+#include "shm_file.h"
+
+static const char *const phase_names[STATS_PHASE_COUNT] = {
+    "db_lookup",
+    "retry_read",
+    "retry_increment",
+    "retry_clear",
+    "verify",
+    "total",
+};
+
+static const char *const outcome_names[STATS_OUTCOME_COUNT] = {
+    "success",
+    "no_user",
+    "no_entry",
+    "retry_unavailable",
+    "locked_out",
+    "prompt_failed",
+    "non_pin",
+    "retry_persist_failed",
+    "authtok_reset_failed",
+    "exhausted",
+};
+
+/* Check that a mapped stats file matches the layout compiled into this binary. */
+static int stats_header_ok(const void *base)
+{
+    const stats_file *stats = (const stats_file *)base;
+
+    return __atomic_load_n(&stats->magic, __ATOMIC_ACQUIRE) == STATS_MAGIC &&
+           stats->version == STATS_VERSION &&
+           stats->phase_count == STATS_PHASE_COUNT &&
+           stats->bucket_count == STATS_BUCKETS &&
+           stats->outcome_count == STATS_OUTCOME_COUNT;
+}
+
+/* Fill in the header of a freshly zeroed stats file. */
+static void stats_header_init(void *base)
+{
+    stats_file *stats = (stats_file *)base;
+
+    stats->version = STATS_VERSION;
+    stats->phase_count = STATS_PHASE_COUNT;
+    stats->bucket_count = STATS_BUCKETS;
+    stats->outcome_count = STATS_OUTCOME_COUNT;
+    /* Publish the magic last so lock-free readers never see a half-written header. */
+    __atomic_store_n(&stats->magic, STATS_MAGIC, __ATOMIC_RELEASE);
+}
+
+/* Return a monotonic timestamp in microseconds, or 0 if the clock is unavailable. */
+uint64_t stats_monotonic_us(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return 0;
+    }
+
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/* Open the shared stats file for recording. Returns NULL on any failure. */
+stats_file *stats_open(const char *retry_dir)
+{
+    return (stats_file *)shm_file_map(retry_dir, STATS_FILE_NAME, sizeof(stats_file), 1,
+                                      stats_header_ok, stats_header_init);
+}
+
+/* Open an existing stats file for reporting only. */
+stats_file *stats_open_readonly(const char *retry_dir)
+{
+    return (stats_file *)shm_file_map(retry_dir, STATS_FILE_NAME, sizeof(stats_file), 0,
+                                      stats_header_ok, stats_header_init);
+}
+
+/* Unmap a stats file returned by stats_open(). NULL is accepted. */
+void stats_close(stats_file *stats)
+{
+    shm_file_unmap(stats, sizeof(stats_file));
+}
+
+/* Add one phase duration to its log2-bucketed histogram. */
+void stats_record_phase(stats_file *stats, stats_phase phase, uint64_t elapsed_us)
+{
+    stats_histogram *hist;
+    int bucket = 0;
+
+    if (stats == NULL || (int)phase < 0 || (int)phase >= STATS_PHASE_COUNT) {
+        return;
+    }
+
+    if (elapsed_us > 1) {
+        bucket = 64 - __builtin_clzll(elapsed_us - 1);
+        if (bucket >= STATS_BUCKETS) {
+            bucket = STATS_BUCKETS - 1;
+        }
+    }
+
+    hist = &stats->phases[phase];
+    (void)__atomic_fetch_add(&hist->buckets[bucket], 1, __ATOMIC_RELAXED);
+    (void)__atomic_fetch_add(&hist->sum_us, elapsed_us, __ATOMIC_RELAXED);
+    (void)__atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+}
+
+/* Count the final outcome of one pam_sm_authenticate call. */
+void stats_record_outcome(stats_file *stats, stats_outcome outcome)
+{
+    if (stats == NULL || (int)outcome < 0 || (int)outcome >= STATS_OUTCOME_COUNT) {
+        return;
+    }
+
+    (void)__atomic_fetch_add(&stats->outcomes[outcome], 1, __ATOMIC_RELAXED);
+}
+
+/* Count a single rejected PIN attempt. */
+void stats_record_wrong_pin(stats_file *stats)
+{
+    if (stats != NULL) {
+        (void)__atomic_fetch_add(&stats->wrong_pins, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/* Return a stable, label-safe name for a phase. */
+const char *stats_phase_name(stats_phase phase)
+{
+    if ((int)phase < 0 || (int)phase >= STATS_PHASE_COUNT) {
+        return "unknown";
+    }
+    return phase_names[phase];
+}
+
+/* Return a stable, label-safe name for an outcome. */
+const char *stats_outcome_name(stats_outcome outcome)
+{
+    if ((int)outcome < 0 || (int)outcome >= STATS_OUTCOME_COUNT) {
+        return "unknown";
+    }
+    return outcome_names[outcome];
+}
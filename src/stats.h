@@ -0,0 +1,74 @@
+#ifndef PAM_PIN_STATS_H
+#define PAM_PIN_STATS_H
+
+#include <stdint.h>
+
+#define STATS_FILE_NAME "pam_pin.stats"
+#define STATS_MAGIC 0x50504e53U
+#define STATS_VERSION 2U
+
+/*
+ * Bucket i counts samples in (2^(i-1), 2^i] microseconds, so 2^i is a true
+ * "less than or equal" bound; bucket 0 holds 0 and 1. The last bucket is
+ * unbounded and collects everything above 2^(STATS_BUCKETS-2) us.
+ */
+#define STATS_BUCKETS 32
+
+typedef enum stats_phase {
+    STATS_PHASE_DB_LOOKUP = 0,
+    STATS_PHASE_RETRY_READ,
+    STATS_PHASE_RETRY_INCREMENT,
+    STATS_PHASE_RETRY_CLEAR,
+    STATS_PHASE_VERIFY,
+    /* Whole pam_sm_authenticate call minus time spent waiting at the prompt. */
+    STATS_PHASE_TOTAL,
+    STATS_PHASE_COUNT
+} stats_phase;
+
+typedef enum stats_outcome {
+    STATS_OUTCOME_SUCCESS = 0,
+    STATS_OUTCOME_NO_USER,
+    STATS_OUTCOME_NO_ENTRY,
+    STATS_OUTCOME_RETRY_UNAVAILABLE,
+    STATS_OUTCOME_LOCKED_OUT,
+    STATS_OUTCOME_PROMPT_FAILED,
+    STATS_OUTCOME_NON_PIN,
+    STATS_OUTCOME_RETRY_PERSIST_FAILED,
+    STATS_OUTCOME_AUTHTOK_RESET_FAILED,
+    STATS_OUTCOME_EXHAUSTED,
+    STATS_OUTCOME_COUNT
+} stats_outcome;
+
+typedef struct stats_histogram {
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t buckets[STATS_BUCKETS];
+} stats_histogram;
+
+/*
+ * Layout of the shared stats file. All counters are updated with relaxed
+ * atomic adds, so concurrent PAM conversations never take a lock.
+ */
+typedef struct stats_file {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t phase_count;
+    uint32_t bucket_count;
+    uint32_t outcome_count;
+    uint32_t reserved;
+    stats_histogram phases[STATS_PHASE_COUNT];
+    uint64_t wrong_pins;
+    uint64_t outcomes[STATS_OUTCOME_COUNT];
+} stats_file;
+
+uint64_t stats_monotonic_us(void);
+stats_file *stats_open(const char *retry_dir);
+stats_file *stats_open_readonly(const char *retry_dir);
+void stats_close(stats_file *stats);
+void stats_record_phase(stats_file *stats, stats_phase phase, uint64_t elapsed_us);
+void stats_record_outcome(stats_file *stats, stats_outcome outcome);
+void stats_record_wrong_pin(stats_file *stats);
+const char *stats_phase_name(stats_phase phase);
+const char *stats_outcome_name(stats_outcome outcome);
+
+#endif